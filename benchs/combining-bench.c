@@ -0,0 +1,157 @@
+#include "loki/queue.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compare the throughput of loki_queue__push (CAS loop) against
+// loki_queue__push_combined (flat combining) for an increasing
+// number of producers.
+//
+// A single consumer drains the queue so the producers' side
+// is the bottleneck.
+
+volatile int exit_now = 0;
+
+struct worker_t {
+    pthread_t tid;
+    struct loki_queue *q;
+    struct loki_queue_combiner *c;
+    uint32_t slot_id;
+
+    uint32_t n;
+    uint32_t push_len;
+
+    uint32_t popped;
+};
+
+void* produce(void* arg) {
+    struct worker_t *ctx = arg;
+    uint32_t block[ctx->push_len];
+
+    for (uint32_t i = 0; i < ctx->push_len; ++i)
+        block[i] = i;
+
+    for (uint32_t i = 0; i < ctx->n;) {
+        uint32_t len = ctx->push_len;
+        if (len > ctx->n - i)
+            len = ctx->n - i;
+
+        uint32_t ret;
+        if (ctx->c)
+            ret = loki_queue__push_combined(ctx->c, ctx->slot_id, block, len, LOKI_SOME_DATA, NULL);
+        else
+            ret = loki_queue__push(ctx->q, block, len, LOKI_SOME_DATA, NULL);
+
+        i += ret;
+    }
+
+    return NULL;
+}
+
+void* consume(void* arg) {
+    struct worker_t *ctx = arg;
+    uint32_t block[64];
+
+    while (1) {
+        // Read the flag *before* the pop: if it was set, all
+        // the producers finished and an empty pop means that
+        // there is nothing else to consume.
+        int exiting = exit_now;
+        uint32_t ret = loki_queue__pop(ctx->q, block, 64, LOKI_SOME_DATA | LOKI_SINGLE, NULL);
+        ctx->popped += ret;
+
+        if (!ret && exiting)
+            break;
+    }
+
+    return NULL;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Return the throughput in millions of pushed elements per second
+static double run(uint32_t queue_sz, int prod_cnt, uint32_t push_len, uint32_t n, int combine) {
+    struct loki_queue q;
+    struct loki_queue_combiner c;
+
+    if (loki_queue__init(&q, queue_sz, sizeof(uint32_t)))
+        return -1;
+
+    if (loki_queue_combiner__init(&c, &q, prod_cnt)) {
+        loki_queue__destroy(&q);
+        return -1;
+    }
+
+    struct worker_t producers[prod_cnt];
+    struct worker_t consumer = { .q = &q, .popped = 0 };
+
+    exit_now = 0;
+    double begin = now();
+
+    pthread_create(&consumer.tid, NULL, consume, &consumer);
+    for (int i = 0; i < prod_cnt; ++i) {
+        producers[i].q = &q;
+        producers[i].c = combine ? &c : NULL;
+        producers[i].slot_id = i;
+        producers[i].n = n;
+        producers[i].push_len = push_len;
+
+        pthread_create(&(producers[i].tid), NULL, produce, &producers[i]);
+    }
+
+    for (int i = 0; i < prod_cnt; ++i)
+        pthread_join(producers[i].tid, NULL);
+
+    exit_now = 1;
+    pthread_join(consumer.tid, NULL);
+
+    double elapsed = now() - begin;
+
+    loki_queue_combiner__destroy(&c);
+    loki_queue__destroy(&q);
+
+    if (consumer.popped != n * prod_cnt) {
+        printf("FAIL: popped %u, expected %u\n", consumer.popped, n * prod_cnt);
+        return -1;
+    }
+
+    return (consumer.popped / elapsed) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    _dbg_warn("Mutex enabled!");
+    if (argc != 5) {
+        fprintf(stderr, "Usage: %s <queue-size> <max-producer-count> <push-len> <elems-per-producer>\n", argv[0]);
+        return -1;
+    }
+
+    int queue_sz = atoi(argv[1]);
+    int max_prod_cnt = atoi(argv[2]);
+    int push_len = atoi(argv[3]);
+    int n = atoi(argv[4]);
+
+    if (queue_sz <= 0 || max_prod_cnt <= 0 || push_len <= 0 || n <= 0)
+        return -2;
+
+    if (max_prod_cnt > LOKI_COMBINER_SLOTS)
+        return -2;
+
+    printf("%10s %14s %14s\n", "producers", "cas (Mops/s)", "comb (Mops/s)");
+    for (int prod_cnt = 1; prod_cnt <= max_prod_cnt; prod_cnt *= 2) {
+        double cas = run(queue_sz, prod_cnt, push_len, n, 0);
+        double comb = run(queue_sz, prod_cnt, push_len, n, 1);
+
+        if (cas < 0 || comb < 0)
+            return -5;
+
+        printf("%10d %14.2f %14.2f\n", prod_cnt, cas, comb);
+    }
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "loki/mailbox.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measure how the reads of a loki_mailbox scale with the number
+// of readers while a single writer keeps updating the value.
+//
+// The readers never write in the mailbox so the total throughput
+// should grow with the readers (as long as there are cores for them).
+
+volatile int exit_now = 0;
+
+struct worker_t {
+    pthread_t tid;
+    struct loki_mailbox *mb;
+    uint32_t elem_sz;
+
+    // writer only: pause between writes in microseconds
+    uint32_t period;
+
+    uint64_t ops;
+};
+
+void* write_all(void* arg) {
+    struct worker_t *ctx = arg;
+    uint8_t value[ctx->elem_sz];
+    memset(value, 0, ctx->elem_sz);
+
+    while (!exit_now) {
+        value[0] = ctx->ops;
+        loki_mailbox__write(ctx->mb, value);
+        ++ctx->ops;
+
+        if (ctx->period)
+            usleep(ctx->period);
+    }
+
+    return NULL;
+}
+
+void* read_all(void* arg) {
+    struct worker_t *ctx = arg;
+    uint8_t value[ctx->elem_sz];
+
+    while (!exit_now) {
+        loki_mailbox__read(ctx->mb, value);
+        ++ctx->ops;
+    }
+
+    return NULL;
+}
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Return the total read throughput in millions of reads per second
+static double run(uint32_t elem_sz, int reader_cnt, uint32_t period, uint32_t duration_ms, uint64_t *writes) {
+    struct loki_mailbox mb;
+    if (loki_mailbox__init(&mb, elem_sz))
+        return -1;
+
+    struct worker_t writer = { .mb = &mb, .elem_sz = elem_sz, .period = period, .ops = 0 };
+    struct worker_t readers[reader_cnt];
+
+    exit_now = 0;
+
+    // Write something first so the readers don't read an empty mailbox
+    uint8_t value[elem_sz];
+    memset(value, 0, elem_sz);
+    loki_mailbox__write(&mb, value);
+
+    double begin = now();
+    pthread_create(&writer.tid, NULL, write_all, &writer);
+    for (int i = 0; i < reader_cnt; ++i) {
+        readers[i].mb = &mb;
+        readers[i].elem_sz = elem_sz;
+        readers[i].ops = 0;
+
+        pthread_create(&(readers[i].tid), NULL, read_all, &readers[i]);
+    }
+
+    usleep(duration_ms * 1000);
+    exit_now = 1;
+
+    uint64_t reads = 0;
+    for (int i = 0; i < reader_cnt; ++i) {
+        pthread_join(readers[i].tid, NULL);
+        reads += readers[i].ops;
+    }
+    pthread_join(writer.tid, NULL);
+
+    double elapsed = now() - begin;
+    loki_mailbox__destroy(&mb);
+
+    *writes = writer.ops;
+    return (reads / elapsed) / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    _dbg_warn("Mutex enabled!");
+    if (argc != 5) {
+        fprintf(stderr, "Usage: %s <elem-size> <max-reader-count> <write-period-us> <duration-ms>\n", argv[0]);
+        return -1;
+    }
+
+    int elem_sz = atoi(argv[1]);
+    int max_reader_cnt = atoi(argv[2]);
+    int period = atoi(argv[3]);
+    int duration_ms = atoi(argv[4]);
+
+    if (elem_sz <= 0 || max_reader_cnt <= 0 || period < 0 || duration_ms <= 0)
+        return -2;
+
+    printf("%10s %16s %20s %10s\n", "readers", "reads (Mops/s)", "per reader (Mops/s)", "writes");
+    for (int reader_cnt = 1; reader_cnt <= max_reader_cnt; reader_cnt *= 2) {
+        uint64_t writes;
+        double reads = run(elem_sz, reader_cnt, period, duration_ms, &writes);
+
+        if (reads < 0)
+            return -5;
+
+        printf("%10d %16.2f %20.2f %10" PRIu64 "\n", reader_cnt, reads, reads / reader_cnt, writes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+extern "C" {
+#include "loki/queue.h"
+}
+#include "loki/queue.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compare loki::queue<uint32_t> against loki_queue__push/pop
+// for a trivially copyable element.
+//
+// A single thread pushes and pops one element at a time so the
+// cost of each call is measured and not the contention.
+
+#define QUEUE_SZ 1024
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Keep the compiler from removing the loops
+volatile uint32_t sink;
+
+// Return the nanoseconds per push+pop
+static double run_c(uint32_t n, int flags) {
+    struct loki_queue q;
+    if (loki_queue__init(&q, QUEUE_SZ, sizeof(uint32_t)))
+        return -1;
+
+    uint32_t sum = 0;
+    double begin = now();
+    for (uint32_t i = 0; i < n; ++i) {
+        uint32_t in = i, out;
+        loki_queue__push(&q, &in, 1, flags, NULL);
+        loki_queue__pop(&q, &out, 1, flags, NULL);
+        sum += out;
+    }
+    double elapsed = now() - begin;
+
+    sink = sum;
+    loki_queue__destroy(&q);
+    return elapsed * 1e9 / n;
+}
+
+template <typename Q>
+static double run_cpp(uint32_t n) {
+    Q *q = new Q;
+
+    uint32_t sum = 0;
+    double begin = now();
+    for (uint32_t i = 0; i < n; ++i) {
+        q->push(i);
+        sum += *q->pop();
+    }
+    double elapsed = now() - begin;
+
+    sink = sum;
+    delete q;
+    return elapsed * 1e9 / n;
+}
+
+int main(int argc, char *argv[]) {
+    _dbg_warn("Mutex enabled!");
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <elems>\n", argv[0]);
+        return -1;
+    }
+
+    int n = atoi(argv[1]);
+    if (n <= 0)
+        return -2;
+
+    double c_mpmc = run_c(n, 0);
+    double c_spsc = run_c(n, LOKI_SINGLE);
+    double cpp_mpmc = run_cpp<loki::queue<uint32_t, QUEUE_SZ, loki::mpmc>>(n);
+    double cpp_spsc = run_cpp<loki::queue<uint32_t, QUEUE_SZ, loki::spsc>>(n);
+
+    if (c_mpmc < 0 || c_spsc < 0)
+        return -5;
+
+    printf("%6s %12s %12s\n", "mode", "c (ns/op)", "c++ (ns/op)");
+    printf("%6s %12.2f %12.2f\n", "mpmc", c_mpmc, cpp_mpmc);
+    printf("%6s %12.2f %12.2f\n", "spsc", c_spsc, cpp_spsc);
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "loki/mailbox.h"
+#include "loki/common.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <assert.h>
+
+// About the seqlock and the memory orders see
+// https://www.hpl.hp.com/techreports/2012/HPL-2012-68.pdf
+
+void loki_mailbox__write(struct loki_mailbox *mb, const void *data) {
+    _dbg_mutex_lock(&mb->mx);
+
+    // We are the only writer: nobody else modifies the seq
+    // so there is no need of an atomic read-modify-write.
+    uint64_t seq = __atomic_load_n(&mb->seq, __ATOMIC_RELAXED);
+    assert(!(seq & 1));
+
+    __atomic_store_n(&mb->seq, seq + 1, __ATOMIC_RELAXED);
+
+    // The stores of the data below cannot be reordered before
+    // the odd seq store above: a reader that sees any of the
+    // new data will see the odd seq (or a newer one) in its
+    // second load and it will retry.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(mb->data, data, mb->elem_sz);
+
+    // RELEASE: pairs with the ACQUIRE load of the readers. If they
+    // see this seq, they see the data too.
+    _dbg_tracef("mailbox write (new)mb->seq=%" PRIu64, seq + 2);
+    __atomic_store_n(&mb->seq, seq + 2, __ATOMIC_RELEASE);
+
+    _dbg_mutex_unlock(&mb->mx);
+}
+
+uint64_t loki_mailbox__read(struct loki_mailbox *mb, void *data) {
+    _dbg_mutex_lock(&mb->mx);
+    uint64_t seq1, seq2;
+
+    do {
+        seq1 = __atomic_load_n(&mb->seq, __ATOMIC_ACQUIRE);
+
+        // The writer is in the middle of a write, the copy
+        // would be torn for sure
+        if (seq1 & 1) {
+            loki_cpu_relax();
+            seq2 = seq1 + 1;
+            continue;
+        }
+
+        memcpy(data, mb->data, mb->elem_sz);
+
+        // The reads of the data above cannot be reordered after
+        // the second load of the seq. If it didn't change, the
+        // writer didn't touch the data while we were copying it.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq2 = __atomic_load_n(&mb->seq, __ATOMIC_RELAXED);
+
+        _dbg_tracef("mailbox read seq1=%" PRIu64 " seq2=%" PRIu64, seq1, seq2);
+    } while (seq1 != seq2);
+
+    _dbg_mutex_unlock(&mb->mx);
+
+    if (!seq1)
+        errno = EAGAIN;
+    return seq1 / 2;
+}
+
+int loki_mailbox__init(struct loki_mailbox *mb, uint32_t elem_sz) {
+    if (!elem_sz) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Align the data to a cache line and round its size up to
+    // a whole number of lines so neither its first nor its last
+    // line is shared with other (hot) data.
+    //
+    // XXX assuming that the L1 and L2 cache lines are of 64 bytes
+    size_t alloc_sz = ((size_t)elem_sz + 63) & ~(size_t)63;
+
+    void *data;
+    int err = posix_memalign(&data, 64, alloc_sz);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+
+    memset(data, 0, alloc_sz);
+    mb->data = data;
+    mb->elem_sz = elem_sz;
+    mb->seq = 0;
+
+    _dbg_mutex_init(&mb->mx);
+    return 0;
+}
+
+void loki_mailbox__destroy(struct loki_mailbox *mb) {
+    _dbg_mutex_destroy(&mb->mx);
+    free(mb->data);
+}
+
+uint64_t loki_mailbox__version(struct loki_mailbox *mb) {
+    return __atomic_load_n(&mb->seq, __ATOMIC_ACQUIRE) / 2;
+}
@@ -0,0 +1,72 @@
+#ifndef LOKI_MAILBOX_H_
+#define LOKI_MAILBOX_H_
+
+#include "loki/debug.h"
+#include <stdint.h>
+
+//
+// Single Writer - Multi Reader Latest-Value Mailbox
+//
+// The mailbox holds only one value: the latest one written.
+// It is meant to broadcast configs or state snapshots: pushing
+// them through a struct loki_queue forces the readers to drain
+// the queue to reach the newest one.
+//
+// It is a sequence lock (seqlock): the writer makes the sequence
+// number odd, writes the value and makes it even again.
+// A reader reads the sequence number, copies the value and reads
+// the sequence number again: if it was odd or it changed, the copy
+// may be torn and the reader retries.
+//
+// The readers only load from the mailbox, they never store in it.
+// Any number of readers can read at the same time without
+// bouncing the cache lines between them, unlike a reader-writer
+// lock where each reader has to write the lock's counter.
+//
+// The writer never waits for the readers. Only one thread may
+// write at a time.
+//
+// References:
+//  - https://www.kernel.org/doc/html/latest/locking/seqlock.html
+//  - https://www.hpl.hp.com/techreports/2012/HPL-2012-68.pdf
+//
+struct loki_mailbox {
+    // Odd while the writer is writing. Its half is the version
+    // of the value in the mailbox (0 means nothing written yet).
+    //
+    // It is 64 bits wide: with 32 bits the version would wrap after
+    // 2^31 writes (less than a minute for a fast writer) and a valid
+    // value would look like an empty mailbox.
+    volatile uint64_t seq;
+
+    // Where the data lives
+    uint8_t *data;
+    // Size of the value that the mailbox will hold
+    uint32_t elem_sz;
+
+    // The attributes above are read (and the seq is written) on every
+    // access to the mailbox. Keep them in their own cache line so
+    // nothing else next to the mailbox causes "false sharing".
+    //
+    // XXX assuming that the L1 and L2 cache lines are of 64 bytes
+    uint32_t _pad1[11];
+
+    _dbg_mutex_var(mx);
+};
+
+// Replace the value of the mailbox. Single writer only.
+void loki_mailbox__write(struct loki_mailbox *mb, const void *data);
+
+// Copy the latest value written into data.
+//
+// Return its version, a number that increases with each write.
+// If nothing was written yet, return 0 and set errno to EAGAIN.
+uint64_t loki_mailbox__read(struct loki_mailbox *mb, void *data);
+
+int loki_mailbox__init(struct loki_mailbox *mb, uint32_t elem_sz);
+void loki_mailbox__destroy(struct loki_mailbox *mb);
+
+// Version of the latest value written (see loki_mailbox__read).
+// Useful to check for a new value without copying it.
+uint64_t loki_mailbox__version(struct loki_mailbox *mb);
+#endif
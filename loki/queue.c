@@ -218,7 +218,12 @@ uint32_t loki_queue__pop(
         // But in the pop we compare the consumer head (not the
         // consumer next head) with the product tail.
         ready_entries = prod_tail - old_cons_head;
-        assert(ready_entries < mask + 1);
+
+        // With multiple consumers old_cons_head may be stale: other
+        // consumers may have moved the head *and* the producers
+        // the tail since we loaded it, so ready_entries may be larger
+        // than the capacity. The CAS will fail and we will retry.
+        assert((flags & LOKI_SINGLE) == 0 || ready_entries < mask + 1);
 
         // Pop as much as we can
         if ((flags & LOKI_SOME_DATA) && (ready_entries < len)) {
@@ -275,6 +280,185 @@ uint32_t loki_queue__pop(
     return n;
 }
 
+#define LOKI_COMBINER_IDLE    0
+#define LOKI_COMBINER_PENDING 1
+#define LOKI_COMBINER_DONE    2
+
+// Serve all the pending requests of the combiner.
+// Only the thread that holds the combiner role may call this.
+static void loki_queue__combine(struct loki_queue_combiner *c) {
+    struct loki_queue *q = c->q;
+    _dbg_mutex_lock(&q->mx);
+
+    uint32_t pending[LOKI_COMBINER_SLOTS];
+    uint32_t reserved[LOKI_COMBINER_SLOTS];
+    uint32_t remain[LOKI_COMBINER_SLOTS];
+    uint32_t pending_cnt = 0;
+
+    // Collect the requests published so far. Those that arrive
+    // later will be served by the next combiner (which may
+    // be ourselves again).
+    //
+    // The ACQUIRE load pairs with the RELEASE store of the producer
+    // that published the request so its len, flags and data are visible.
+    for (uint32_t i = 0; i < c->slots_cnt; ++i) {
+        if (__atomic_load_n(&c->slots[i].state, __ATOMIC_ACQUIRE) == LOKI_COMBINER_PENDING)
+            pending[pending_cnt++] = i;
+    }
+
+    uint32_t old_prod_head, cons_tail, new_prod_head;
+    uint32_t mask = q->prod_mask;
+    uint32_t capacity = mask;
+    uint32_t total;
+    int success;
+
+    // Same CAS loop than loki_queue__push but reserving
+    // the space for the whole group at once.
+    //
+    // We still need the CAS: other threads may be pushing
+    // with loki_queue__push concurrently.
+    old_prod_head = __atomic_load_n(&q->prod_head, __ATOMIC_RELAXED);
+    do {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        cons_tail = __atomic_load_n(&q->cons_tail, __ATOMIC_ACQUIRE);
+
+        uint32_t free_entries = (capacity + cons_tail - old_prod_head);
+
+        // Split the free entries among the requests in order.
+        // Each request keeps the semantics of loki_queue__push:
+        // all or nothing unless LOKI_SOME_DATA was given.
+        total = 0;
+        for (uint32_t k = 0; k < pending_cnt; ++k) {
+            struct loki_queue_combiner_slot *slot = &c->slots[pending[k]];
+            uint32_t n = slot->len;
+
+            if (n > free_entries - total)
+                n = (slot->flags & LOKI_SOME_DATA) ? free_entries - total : 0;
+
+            reserved[k] = n;
+            total += n;
+            remain[k] = free_entries - total;
+        }
+
+        _dbg_tracef("combine cas total=%u free=%u q->cons_tail=%u (old)q->prod_head=%u",
+                total, free_entries, cons_tail, old_prod_head);
+
+        if (!total)
+            break;
+
+        new_prod_head = (old_prod_head + total);
+        success = __atomic_compare_exchange_n(
+                        &q->prod_head,
+                        &old_prod_head,
+                        new_prod_head,
+                        false,
+                        __ATOMIC_RELAXED,
+                        __ATOMIC_RELAXED
+                    );
+    } while (!success);
+
+    if (total) {
+        // Copy the data of each request one after the other
+        uint32_t pos = old_prod_head;
+        for (uint32_t k = 0; k < pending_cnt; ++k) {
+            uint8_t *_data = c->slots[pending[k]].data;
+            for (uint32_t i = 0; i < reserved[k]; ++i, ++pos)
+                memcpy(&q->data[(pos & mask) * q->elem_sz], &_data[i * q->elem_sz], q->elem_sz);
+        }
+        assert(pos == new_prod_head);
+
+        // Wait for the previous pushes (non combined) and
+        // publish the data of the whole group once.
+        while (q->prod_tail != old_prod_head) {
+            loki_cpu_relax();
+        }
+
+        _dbg_tracef("combine release q->prod_tail=%u (new)prod_head=%u",
+                q->prod_tail, new_prod_head);
+        __atomic_store_n(&q->prod_tail, new_prod_head, __ATOMIC_RELEASE);
+    }
+    _dbg_mutex_unlock(&q->mx);
+
+    // Let the producers know the results. The RELEASE store
+    // pairs with the ACQUIRE load of the producer spinning on its slot.
+    for (uint32_t k = 0; k < pending_cnt; ++k) {
+        struct loki_queue_combiner_slot *slot = &c->slots[pending[k]];
+        slot->ret = reserved[k];
+        slot->free_entries_remain = remain[k];
+        __atomic_store_n(&slot->state, LOKI_COMBINER_DONE, __ATOMIC_RELEASE);
+    }
+}
+
+uint32_t loki_queue__push_combined(
+        struct loki_queue_combiner *c,
+        uint32_t slot_id,
+        void *data,
+        uint32_t len,
+        int flags,
+        uint32_t *free_entries_remain
+        ) {
+    assert(slot_id < c->slots_cnt);
+    struct loki_queue_combiner_slot *slot = &c->slots[slot_id];
+    assert(slot->state == LOKI_COMBINER_IDLE);
+
+    // Publish our request. The RELEASE ensures that the combiner
+    // will see the request's data once it sees the pending state.
+    slot->data = data;
+    slot->len = len;
+    slot->flags = flags;
+    __atomic_store_n(&slot->state, LOKI_COMBINER_PENDING, __ATOMIC_RELEASE);
+
+    while (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != LOKI_COMBINER_DONE) {
+        // Try to become the combiner. Check first with a plain
+        // load so we don't write on the lock's cache line while
+        // other thread is combining (test and test-and-set)
+        if (!__atomic_load_n(&c->lock, __ATOMIC_RELAXED)
+                && !__atomic_exchange_n(&c->lock, 1, __ATOMIC_ACQUIRE)) {
+            // Our request was pending so it is served for sure
+            loki_queue__combine(c);
+            __atomic_store_n(&c->lock, 0, __ATOMIC_RELEASE);
+        }
+        else {
+            loki_cpu_relax();
+        }
+    }
+
+    uint32_t n = slot->ret;
+    if (free_entries_remain)
+        *free_entries_remain = slot->free_entries_remain;
+
+    // The slot is ours again. The combiners may be scanning it
+    // so this must be atomic.
+    __atomic_store_n(&slot->state, LOKI_COMBINER_IDLE, __ATOMIC_RELAXED);
+
+    if (!n)
+        errno = EAGAIN;
+    return n;
+}
+
+int loki_queue_combiner__init(
+        struct loki_queue_combiner *c,
+        struct loki_queue *q,
+        uint32_t slots_cnt
+        ) {
+    if (!slots_cnt || slots_cnt > LOKI_COMBINER_SLOTS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c->lock = 0;
+    for (uint32_t i = 0; i < slots_cnt; ++i)
+        c->slots[i].state = LOKI_COMBINER_IDLE;
+
+    c->slots_cnt = slots_cnt;
+    c->q = q;
+    return 0;
+}
+
+void loki_queue_combiner__destroy(struct loki_queue_combiner *c) {
+    c->q = NULL;
+}
+
 int loki_queue__init(struct loki_queue *q, uint32_t sz, uint32_t elem_sz) {
     // Power of 2 only
     if (!sz || (sz & (sz-1))) {
@@ -90,6 +90,102 @@ uint32_t loki_queue__pop(
         uint32_t *ready_entries_remain
         );
 
+//
+// Flat combining for the producers' side
+//
+// Under heavy producer contention the CAS loop on prod_head of
+// loki_queue__push retries a lot and the cache line with the
+// producer's head/tail bounces between the cores.
+//
+// With flat combining each producer publishes its push request
+// in its own slot. Then, whoever takes the combiner role serves
+// all the pending requests of the group: it reserves space for all
+// of them with a single CAS, copies the data and moves the
+// prod_tail once.
+//
+// The rest of the producers just spin on their own slot (in their
+// own cache line) waiting for the result.
+//
+// The combining and the traditional push can be mixed on the same
+// queue; consumers are not affected at all.
+//
+// References:
+//  - https://people.csail.mit.edu/shanir/publications/Flat%20Combining%20SPAA%2010.pdf
+//
+#ifndef LOKI_COMBINER_SLOTS
+#define LOKI_COMBINER_SLOTS 64
+#endif
+
+struct loki_queue_combiner_slot {
+    // Idle, pending (published by the producer) or done (served
+    // by the combiner).
+    volatile uint32_t state;
+
+    // The request, written by the producer before
+    // setting the state to pending
+    uint32_t len;
+    int flags;
+    void *data;
+
+    // The response, written by the combiner before
+    // setting the state to done
+    uint32_t ret;
+    uint32_t free_entries_remain;
+
+    // One slot per cache line so a producer spinning on its
+    // slot does not interfere with the others. The padding fills
+    // the line and the alignment makes every slot (and therefore
+    // any struct loki_queue_combiner, even on the stack) start
+    // at the beginning of a line.
+    //
+    // XXX assuming that the L1 and L2 cache lines are of 64 bytes
+    uint32_t _pad[8];
+} __attribute__ ((aligned (64)));
+
+struct loki_queue_combiner {
+    // Who holds this owns the combiner role
+    volatile uint32_t lock;
+
+    // How many slots are in use (the first slots_cnt). The combiner
+    // scans only these: each slot is a cache line and scanning
+    // idle slots is mostly cache misses.
+    //
+    // It lives with the lock and the queue: the combiner has
+    // the line in its cache already after taking the lock.
+    uint32_t slots_cnt;
+    struct loki_queue *q;
+
+    uint32_t _pad1[12];
+
+    struct loki_queue_combiner_slot slots[LOKI_COMBINER_SLOTS];
+};
+
+// Push the data like loki_queue__push but through the combiner c.
+//
+// Each producer thread must use its own slot_id, an index between
+// 0 and the slots_cnt given to loki_queue_combiner__init minus 1.
+// Two threads pushing concurrently
+// with the same slot_id is undefined behaviour.
+//
+// The LOKI_SINGLE flag is ignored: it makes no sense to combine the
+// pushes of a single producer.
+uint32_t loki_queue__push_combined(
+        struct loki_queue_combiner *c,
+        uint32_t slot_id,
+        void *data,
+        uint32_t len,
+        int flags,
+        uint32_t *free_entries_remain
+        );
+
+// Use up to slots_cnt producers (between 1 and LOKI_COMBINER_SLOTS).
+int loki_queue_combiner__init(
+        struct loki_queue_combiner *c,
+        struct loki_queue *q,
+        uint32_t slots_cnt
+        );
+void loki_queue_combiner__destroy(struct loki_queue_combiner *c);
+
 int loki_queue__init(struct loki_queue *q, uint32_t sz, uint32_t elem_sz);
 void loki_queue__destroy(struct loki_queue *q);
 
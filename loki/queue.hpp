@@ -0,0 +1,254 @@
+#ifndef LOKI_QUEUE_HPP_
+#define LOKI_QUEUE_HPP_
+
+#include "loki/debug.h"
+#include "loki/common.h"
+
+#include <stdint.h>
+
+#include <cassert>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace loki {
+
+// Modes of a loki::queue. They play the role of the LOKI_SINGLE
+// flag of the C API but they are fixed at compile time so
+// the compiler can remove the CAS loops entirely.
+//
+// spsc: one producer and one consumer only
+// mpmc: multiple producers and multiple consumers
+struct spsc {};
+struct mpmc {};
+
+//
+// Typed Multi Producer - Multi Consumer Bounded Queue
+//
+// This is the C++ version of struct loki_queue: same head/tail
+// algorithm, same memory orders (see loki/queue.c for the details)
+// but the elements are of type T instead of opaque blobs of elem_sz
+// bytes.
+//
+// The elements are constructed in place (emplace) in the queue's
+// slots and moved out on pop so there is no need to serialize them
+// into PODs first.
+//
+// Once a slot is reserved nothing can fail: an exception there would
+// leave the slot reserved forever and the other threads would spin
+// waiting for it. Hence T's move constructor and destructor, and
+// the constructor called by emplace, must not throw.
+//
+// N is the size of the queue and it must be a power of 2. Like
+// its C sibling, the queue can hold only N-1 elements.
+//
+// The mask and the element size are known at compile time: for
+// trivially copyable T the copy is reduced to a plain store/load and
+// the "% N" to an "& constant", which is at least as cheap as the
+// memcpy of loki_queue__push/pop.
+//
+template <typename T, uint32_t N, typename Mode = mpmc>
+class queue {
+    static_assert(N >= 2 && (N & (N-1)) == 0, "Queue size must be a power of 2");
+    static_assert(std::is_same<Mode, spsc>::value || std::is_same<Mode, mpmc>::value,
+            "Mode must be loki::spsc or loki::mpmc");
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+            "T must be nothrow move constructible: a throwing move in the middle "
+            "of a pop would leave a reserved slot that nobody can release");
+    static_assert(std::is_nothrow_destructible<T>::value,
+            "T must be nothrow destructible");
+
+    static constexpr uint32_t mask = N - 1;
+    static constexpr bool single = std::is_same<Mode, spsc>::value;
+
+    public:
+    typedef T value_type;
+    static constexpr uint32_t capacity = mask;
+
+    queue() : prod_head(0), prod_tail(0), cons_head(0), cons_tail(0) {
+        _dbg_mutex_init(&mx);
+    }
+
+    queue(const queue&) = delete;
+    queue& operator=(const queue&) = delete;
+
+    // Not thread safe: nobody else may be using the queue
+    // by the time that it is destroyed.
+    ~queue() {
+        if (!std::is_trivially_destructible<T>::value) {
+            for (uint32_t i = cons_tail; i != prod_tail; ++i)
+                slot(i)->~T();
+        }
+        _dbg_mutex_destroy(&mx);
+    }
+
+    // Construct a new element at the end of the queue forwarding
+    // the arguments to T's constructor.
+    //
+    // Return false if the queue is full (like loki_queue__push
+    // returning 0 with EAGAIN).
+    //
+    // T's constructor must not throw: the slot is already reserved
+    // by the time that it is called. If it may throw, build the T
+    // first and push it instead.
+    template <typename... Args>
+    bool emplace(Args&&... args) {
+        static_assert(std::is_nothrow_constructible<T, Args&&...>::value,
+                "The constructor of T called by emplace must not throw");
+        _dbg_mutex_lock(&mx);
+        uint32_t old_prod_head, cons_tail_, new_prod_head;
+        int success;
+
+        old_prod_head = __atomic_load_n(&prod_head, __ATOMIC_RELAXED);
+        do {
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            cons_tail_ = __atomic_load_n(&cons_tail, __ATOMIC_ACQUIRE);
+
+            uint32_t free_entries = (capacity + cons_tail_ - old_prod_head);
+            if (!free_entries) {
+                _dbg_mutex_unlock(&mx);
+                return false;
+            }
+
+            new_prod_head = old_prod_head + 1;
+            success = 1;
+            if (single)
+                prod_head = new_prod_head;
+            else
+                success = __atomic_compare_exchange_n(
+                                &prod_head,
+                                &old_prod_head,
+                                new_prod_head,
+                                false,
+                                __ATOMIC_RELAXED,
+                                __ATOMIC_RELAXED
+                            );
+        } while (!success);
+
+        ::new (raw_slot(old_prod_head)) T(std::forward<Args>(args)...);
+
+        while (!single && prod_tail != old_prod_head) {
+            loki_cpu_relax();
+        }
+
+        __atomic_store_n(&prod_tail, new_prod_head, __ATOMIC_RELEASE);
+        _dbg_mutex_unlock(&mx);
+        return true;
+    }
+
+    // Push a copy of elem. If the copy may throw, it is done before
+    // reserving the slot and then it is moved into the queue.
+    bool push(const T& elem) {
+        if constexpr (std::is_nothrow_copy_constructible<T>::value) {
+            return emplace(elem);
+        }
+        else {
+            T copy(elem);
+            return emplace(std::move(copy));
+        }
+    }
+
+    bool push(T&& elem) { return emplace(std::move(elem)); }
+
+    // Move the first element of the queue out and destroy
+    // the moved-from element in the slot.
+    //
+    // Return an empty optional if the queue is empty (like
+    // loki_queue__pop returning 0 with EAGAIN).
+    std::optional<T> pop() {
+        _dbg_mutex_lock(&mx);
+        uint32_t old_cons_head, prod_tail_, new_cons_head;
+        int success;
+
+        old_cons_head = __atomic_load_n(&cons_head, __ATOMIC_RELAXED);
+        do {
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            prod_tail_ = __atomic_load_n(&prod_tail, __ATOMIC_ACQUIRE);
+
+            uint32_t ready_entries = prod_tail_ - old_cons_head;
+            // With multiple consumers old_cons_head may be stale (other
+            // consumers moved the head and the tail since we read it) so
+            // ready_entries may be larger than the capacity. The CAS
+            // below will fail and we will retry with the fresh head.
+            assert(!single || ready_entries < mask + 1);
+            if (!ready_entries) {
+                _dbg_mutex_unlock(&mx);
+                return std::nullopt;
+            }
+
+            new_cons_head = old_cons_head + 1;
+            success = 1;
+            if (single)
+                cons_head = new_cons_head;
+            else
+                success = __atomic_compare_exchange_n(
+                                &cons_head,
+                                &old_cons_head,
+                                new_cons_head,
+                                false,
+                                __ATOMIC_RELAXED,
+                                __ATOMIC_RELAXED
+                            );
+        } while (!success);
+
+        // Move construct (not assign) so T does not need to be
+        // default constructible nor assignable
+        std::optional<T> out;
+        T *elem = slot(old_cons_head);
+        out.emplace(std::move(*elem));
+        elem->~T();
+
+        while (!single && cons_tail != old_cons_head) {
+            loki_cpu_relax();
+        }
+
+        __atomic_store_n(&cons_tail, new_cons_head, __ATOMIC_RELEASE);
+        _dbg_mutex_unlock(&mx);
+        return out;
+    }
+
+    uint32_t ready() const {
+        return prod_tail - cons_head;
+    }
+
+    uint32_t free() const {
+        return capacity + cons_tail - prod_head;
+    }
+
+    private:
+    // Storage of the slot, there may not be a T there (yet)
+    void* raw_slot(uint32_t pos) {
+        return &data[(pos & mask) * sizeof(T)];
+    }
+
+    // The T living in the slot
+    T* slot(uint32_t pos) {
+        return std::launder(static_cast<T*>(raw_slot(pos)));
+    }
+
+    // Same layout than struct loki_queue: producer's and consumer's
+    // attributes in their own cache lines (see loki/queue.h).
+    // The masks are not stored, they are compile time constants.
+    //
+    // XXX assuming that the L1 and L2 cache lines are of 64 bytes
+    volatile uint32_t prod_head;
+    volatile uint32_t prod_tail;
+
+    uint32_t _pad1[14];
+
+    volatile uint32_t cons_head;
+    volatile uint32_t cons_tail;
+
+    uint32_t _pad2[14];
+
+    // Where the data live. Unlike the C version, the storage is
+    // part of the queue because its size is known at compile time.
+    alignas(T) unsigned char data[N * sizeof(T)];
+
+    _dbg_mutex_var(mx);
+};
+
+}
+
+#endif
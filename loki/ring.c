@@ -0,0 +1,192 @@
+#include "loki/ring.h"
+#include "loki/common.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <assert.h>
+
+// About the seqlock and the memory orders see
+// https://www.hpl.hp.com/techreports/2012/HPL-2012-68.pdf
+
+static void loki_ring__write_entry(
+        struct loki_ring *r,
+        uint64_t seq,
+        const uint8_t *elem
+        ) {
+    uint32_t pos = seq & r->prod_mask;
+    volatile uint64_t *slot_seq = &r->seqs[pos];
+
+    uint64_t writing = 2 * seq + 1;
+    uint64_t cur = __atomic_load_n(slot_seq, __ATOMIC_RELAXED);
+
+    // Take the slot. If a newer entry is there (or it is being written)
+    // we were overwritten before even starting: drop our entry.
+    //
+    // If an older entry is being written, wait for it. This happens only
+    // if the producers lap the whole ring during a single copy and we
+    // cannot let two producers write the same slot at the same time:
+    // the reader could not detect that the copy is mixed.
+    do {
+        if (cur >= writing) {
+            _dbg_tracef("ring drop seq=%" PRIu64 " slot_seq=%" PRIu64, seq, cur);
+            return;
+        }
+
+        if (cur & 1) {
+            loki_cpu_relax();
+            cur = __atomic_load_n(slot_seq, __ATOMIC_RELAXED);
+            continue;
+        }
+    } while (!__atomic_compare_exchange_n(
+                    slot_seq,
+                    &cur,
+                    writing,
+                    false,
+                    __ATOMIC_RELAXED,
+                    __ATOMIC_RELAXED
+                ));
+
+    // The stores of the data below cannot be reordered before the
+    // odd sequence number stored above: a reader that sees any of
+    // the new data will see the odd (or a newer) sequence number in
+    // its second load and it will discard the copy.
+    //
+    // An ACQUIRE on the CAS would not be enough: it orders the
+    // loads and stores after it against the CAS' load, not its store.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(&r->data[pos * r->elem_sz], elem, r->elem_sz);
+
+    // RELEASE: pairs with the ACQUIRE load of the reader so
+    // if it sees the sequence number it sees the data too.
+    __atomic_store_n(slot_seq, writing + 1, __ATOMIC_RELEASE);
+}
+
+uint32_t loki_ring__push(
+        struct loki_ring *r,
+        void *data,
+        uint32_t len
+        ) {
+    _dbg_mutex_lock(&r->mx);
+
+    // Reserve the entries. There is no check against the readers:
+    // the ring is never full.
+    uint64_t seq = __atomic_fetch_add(&r->head, len, __ATOMIC_RELAXED);
+
+    _dbg_tracef("ring push len=%u (old)r->head=%" PRIu64, len, seq);
+
+    uint8_t *_data = data;
+    for (uint32_t i = 0; i < len; ++i)
+        loki_ring__write_entry(r, seq + i, &_data[i * r->elem_sz]);
+
+    _dbg_mutex_unlock(&r->mx);
+    return len;
+}
+
+uint32_t loki_ring__read(
+        struct loki_ring *r,
+        struct loki_ring_reader *reader,
+        void *data,
+        uint32_t len,
+        uint64_t *dropped
+        ) {
+    _dbg_mutex_lock(&r->mx);
+
+    uint8_t *_data = data;
+    uint32_t mask = r->read_mask;
+    uint32_t n = 0;
+    uint64_t skipped = 0;
+
+    while (n < len) {
+        uint64_t seq = reader->next;
+        uint32_t pos = seq & mask;
+        volatile uint64_t *slot_seq = &r->seqs[pos];
+
+        uint64_t written = 2 * seq + 2;
+        uint64_t cur = __atomic_load_n(slot_seq, __ATOMIC_ACQUIRE);
+
+        // Not written yet (or still being written)
+        if (cur < written)
+            break;
+
+        if (cur == written) {
+            memcpy(&_data[n * r->elem_sz], &r->data[pos * r->elem_sz], r->elem_sz);
+
+            // The fence forbids the reads of the data above to be
+            // reordered after the second read of the sequence number.
+            // If it didn't change, nobody wrote the slot while
+            // we were copying it.
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(slot_seq, __ATOMIC_RELAXED) == written) {
+                ++n;
+                reader->next = seq + 1;
+                continue;
+            }
+        }
+
+        // Overwritten: the producers lapped us. Skip to the oldest
+        // entry that may still be in the ring; everything before
+        // is lost.
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+        uint64_t sz = (uint64_t)mask + 1;
+        uint64_t next = seq + 1;
+        if (head > sz && head - sz > next)
+            next = head - sz;
+
+        _dbg_tracef("ring skip seq=%" PRIu64 " slot_seq=%" PRIu64 " next=%" PRIu64, seq, cur, next);
+
+        skipped += next - seq;
+        reader->next = next;
+    }
+
+    _dbg_mutex_unlock(&r->mx);
+
+    if (dropped)
+        *dropped += skipped;
+
+    if (!n)
+        errno = EAGAIN;
+    return n;
+}
+
+int loki_ring__init(struct loki_ring *r, uint32_t sz, uint32_t elem_sz) {
+    // Power of 2 only
+    if (!sz || (sz & (sz-1))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    r->prod_mask = r->read_mask = (sz-1);
+
+    // Zero is not a valid sequence number for any slot
+    // (the first entry, seq 0, is 1 while written and 2 once written)
+    r->seqs = calloc(sz, sizeof(*r->seqs));
+    if (!r->seqs)
+        return -1;
+
+    r->data = malloc(elem_sz * sz);
+    if (!r->data) {
+        free((void*)r->seqs);
+        return -1;
+    }
+
+    r->elem_sz = elem_sz;
+    r->head = 0;
+
+    _dbg_mutex_init(&r->mx);
+    return 0;
+}
+
+void loki_ring__destroy(struct loki_ring *r) {
+    _dbg_mutex_destroy(&r->mx);
+    free((void*)r->seqs);
+    free(r->data);
+}
+
+void loki_ring_reader__init(struct loki_ring_reader *reader, struct loki_ring *r) {
+    reader->next = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+}
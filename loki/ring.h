@@ -0,0 +1,117 @@
+#ifndef LOKI_RING_H_
+#define LOKI_RING_H_
+
+#include "loki/debug.h"
+#include <stdint.h>
+
+//
+// Multi Producer - Multi Reader Lossy Ring
+//
+// Unlike struct loki_queue, when the ring is full the producers
+// do not fail with EAGAIN: they overwrite the oldest entries.
+// This is the right trade-off for metrics, sampling and other
+// telemetry streams where the newest data is more valuable than
+// the oldest. It is the same idea behind _dbg_trace_buf but safe
+// for concurrent readers.
+//
+// Each slot has its own sequence number, like in a seqlock:
+//  - 2*seq+1 while the entry seq is being written
+//  - 2*seq+2 once the entry seq was written completely
+//
+// A reader knows which entry it expects in each slot. If the
+// slot's sequence number is newer than that, the entry was
+// overwritten and the reader skips it (and the rest of the
+// overwritten entries) counting how many were dropped. If the
+// sequence number changes while the reader is copying the entry,
+// the copy is torn and it is discarded.
+//
+// Readers do not consume the entries: each reader has its own
+// cursor (struct loki_ring_reader) so multiple readers see the
+// same stream independently and they never write in the ring.
+//
+// The ring has a size of N where N must be a power of 2. Unlike
+// struct loki_queue, all the N slots are usable.
+//
+// The sequence numbers are 64 bits wide: with 32 bits a reader
+// that stalls for 2^32 entries could take an entry from an
+// ancient lap as fresh.
+//
+// References:
+//  - https://www.kernel.org/doc/html/latest/locking/seqlock.html
+//  - https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+//
+struct loki_ring {
+    // Sequence number of the next entry to write. Producers
+    // reserve entries moving it forward. It never waits for
+    // the readers.
+    volatile uint64_t head;
+
+    // Size minus 1, see the comments of prod_mask in loki/queue.h
+    uint32_t prod_mask;
+
+    // The head is written on every push: keep it (and the
+    // producers' copy of the mask) in their own cache line so
+    // the readers do not miss on it for every entry that they
+    // read (see _pad1 in loki/queue.h)
+    //
+    // XXX assuming that the L1 and L2 cache lines are of 64 bytes
+    uint32_t _pad1[13];
+
+    // The readers' copy of the mask. Like cons_mask in
+    // loki/queue.h, it lives in the line of the attributes that
+    // the readers use and nobody writes after the init.
+    uint32_t read_mask;
+
+    // Sequence number of each slot (see above)
+    volatile uint64_t *seqs;
+
+    // Where the data live
+    uint8_t *data;
+    // Size of the element that the loki will hold
+    uint32_t elem_sz;
+
+    uint32_t _pad2[9];
+
+    _dbg_mutex_var(mx);
+};
+
+// Cursor of a reader. It is private to the reader's thread.
+struct loki_ring_reader {
+    // Sequence number of the next entry to read
+    uint64_t next;
+};
+
+// Push len elements overwriting the oldest entries if the ring
+// is full. It always succeeds and returns len.
+//
+// If the ring is so small (or the producers so many) that a newer
+// entry is written in a slot before this push gets there, the
+// entry of this push is dropped: the readers will count it as
+// dropped too.
+uint32_t loki_ring__push(
+        struct loki_ring *r,
+        void *data,
+        uint32_t len
+        );
+
+// Read up to len entries in order from the reader's cursor.
+//
+// Overwritten entries are skipped and their count is added
+// to dropped (if given).
+//
+// Return how many entries were read. If none, set errno to EAGAIN.
+uint32_t loki_ring__read(
+        struct loki_ring *r,
+        struct loki_ring_reader *reader,
+        void *data,
+        uint32_t len,
+        uint64_t *dropped
+        );
+
+int loki_ring__init(struct loki_ring *r, uint32_t sz, uint32_t elem_sz);
+void loki_ring__destroy(struct loki_ring *r);
+
+// Start reading from the next entry to be pushed: the entries
+// already in the ring are not seen by this reader.
+void loki_ring_reader__init(struct loki_ring_reader *reader, struct loki_ring *r);
+#endif
@@ -0,0 +1,147 @@
+#include "loki/mailbox.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+volatile int exit_now = 0;
+
+struct worker_t {
+    pthread_t tid;
+    struct loki_mailbox *mb;
+
+    // All the words of a value are the same number
+    // so a torn read can be detected
+    uint32_t elem_words;
+
+    // writer only
+    uint32_t n;
+
+    // reader only
+    uint32_t reads;
+    uint64_t last_version;
+    int failed;
+};
+
+void* write_all(void* arg) {
+    struct worker_t *ctx = arg;
+    uint32_t value[ctx->elem_words];
+
+    for (uint32_t i = 1; i <= ctx->n; ++i) {
+        for (uint32_t k = 0; k < ctx->elem_words; ++k)
+            value[k] = i;
+
+        loki_mailbox__write(ctx->mb, value);
+    }
+
+    return NULL;
+}
+
+void* read_all(void* arg) {
+    struct worker_t *ctx = arg;
+    uint32_t value[ctx->elem_words];
+
+    while (1) {
+        // Read the flag before reading the mailbox: if it was set,
+        // the writer finished and we must see its last value.
+        int exiting = exit_now;
+        uint64_t version = loki_mailbox__read(ctx->mb, value);
+
+        if (version) {
+            for (uint32_t k = 0; k < ctx->elem_words; ++k) {
+                if (value[k] != version) {
+                    printf("FAIL: torn read, word %u is %u, expected %" PRIu64 "\n",
+                            k, value[k], version);
+                    ctx->failed = 1;
+                    break;
+                }
+            }
+
+            if (version < ctx->last_version) {
+                printf("FAIL: version %" PRIu64 " after %" PRIu64 "\n", version, ctx->last_version);
+                ctx->failed = 1;
+            }
+
+            ctx->last_version = version;
+            ++ctx->reads;
+        }
+
+        if (exiting || ctx->failed)
+            break;
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    _dbg_warn("Mutex enabled!");
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <elem-words> <reader-count> <write-count>\n", argv[0]);
+        return -1;
+    }
+
+    struct loki_mailbox mb;
+    int elem_words = atoi(argv[1]);
+    int reader_cnt = atoi(argv[2]);
+    int n = atoi(argv[3]);
+
+    if (elem_words <= 0 || reader_cnt < 0 || n <= 0)
+        return -2;
+
+    if (loki_mailbox__init(&mb, elem_words * sizeof(uint32_t)))
+        return -4;
+
+    uint32_t value[elem_words];
+    if (loki_mailbox__read(&mb, value) != 0)
+        return -5;
+
+    struct worker_t writer = { .mb = &mb, .elem_words = elem_words, .n = n };
+    struct worker_t readers[reader_cnt];
+
+    for (int i = 0; i < reader_cnt; ++i) {
+        readers[i].mb = &mb;
+        readers[i].elem_words = elem_words;
+        readers[i].reads = 0;
+        readers[i].last_version = 0;
+        readers[i].failed = 0;
+
+        pthread_create(&(readers[i].tid), NULL, read_all, &readers[i]);
+    }
+
+    pthread_create(&writer.tid, NULL, write_all, &writer);
+
+    printf("Waiting for the writer\n");
+    pthread_join(writer.tid, NULL);
+
+    printf("Signal the readers to exit\n");
+    exit_now = 1;
+
+    int ret = 0;
+    for (int i = 0; i < reader_cnt; ++i) {
+        pthread_join(readers[i].tid, NULL);
+        printf("Reader %i done: %u reads, last version %" PRIu64 "\n",
+                i, readers[i].reads, readers[i].last_version);
+
+        if (readers[i].failed) {
+            ret = -5;
+        }
+        else if (readers[i].last_version != (uint64_t)n) {
+            printf("FAIL: reader %i last version %" PRIu64 ", expected %i\n",
+                    i, readers[i].last_version, n);
+            ret = -5;
+        }
+    }
+
+    if (loki_mailbox__version(&mb) != (uint64_t)n)
+        ret = -5;
+
+    loki_mailbox__destroy(&mb);
+
+    if (ret)
+        return ret;
+
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include "loki/queue.hpp"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <memory>
+
+// The size of a loki::queue is fixed at compile time
+#define QUEUE_SZ 4096
+
+// Small enough to be filled and to wrap around many times
+#define SMALL_QUEUE_SZ 16
+
+// A move-only type to check that the elements are moved in and out
+// of the queue and not copied. It counts how many are alive to check
+// that the queue destroys all of them.
+struct tracked_t {
+    std::unique_ptr<uint32_t> val;
+
+    static int alive;
+
+    explicit tracked_t(uint32_t v) noexcept : val(new uint32_t(v)) { __atomic_add_fetch(&alive, 1, __ATOMIC_RELAXED); }
+    tracked_t(tracked_t&& other) noexcept : val(std::move(other.val)) { __atomic_add_fetch(&alive, 1, __ATOMIC_RELAXED); }
+    ~tracked_t() { __atomic_sub_fetch(&alive, 1, __ATOMIC_RELAXED); }
+};
+
+int tracked_t::alive = 0;
+
+static uint32_t value_of(const tracked_t& elem) { return *elem.val; }
+static uint32_t value_of(uint32_t elem) { return elem; }
+
+typedef loki::queue<tracked_t, QUEUE_SZ, loki::mpmc> mpmc_queue_t;
+typedef loki::queue<tracked_t, QUEUE_SZ, loki::spsc> spsc_queue_t;
+typedef loki::queue<tracked_t, SMALL_QUEUE_SZ, loki::mpmc> small_mpmc_queue_t;
+typedef loki::queue<tracked_t, SMALL_QUEUE_SZ, loki::spsc> small_spsc_queue_t;
+
+// Trivially copyable elements, like the C version
+typedef loki::queue<uint32_t, SMALL_QUEUE_SZ, loki::mpmc> small_u32_queue_t;
+
+static_assert(mpmc_queue_t::capacity == QUEUE_SZ - 1, "Unexpected capacity");
+
+volatile int exit_now = 0;
+
+template <typename Q>
+struct worker_t {
+    pthread_t tid;
+    Q *q;
+
+    // prod only
+    uint32_t start_n;
+    uint32_t n;
+
+    // cons only
+    uint64_t sum;
+};
+
+template <typename Q>
+void* produce(void* arg) {
+    worker_t<Q> *ctx = static_cast<worker_t<Q>*>(arg);
+
+    uint32_t end = ctx->start_n + ctx->n;
+    for (uint32_t i = ctx->start_n; i < end;) {
+        if (ctx->q->emplace(i))
+            ++i;
+    }
+
+    return NULL;
+}
+
+template <typename Q>
+void* consume(void* arg) {
+    worker_t<Q> *ctx = static_cast<worker_t<Q>*>(arg);
+
+    while (1) {
+        // Read the flag before the pop: if it was set, all
+        // the producers finished and an empty pop means that
+        // there is nothing else to consume.
+        int exiting = exit_now;
+        auto elem = ctx->q->pop();
+        if (elem) {
+            ctx->sum += value_of(*elem);
+        }
+        else if (exiting) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// Push the numbers from 1 to total-1 and check that they were all popped
+template <typename Q>
+int run(int prod_cnt, int cons_cnt, uint32_t total) {
+    Q *q = new Q;
+    worker_t<Q> producers[prod_cnt];
+    worker_t<Q> consumers[cons_cnt];
+
+    exit_now = 0;
+    for (int i = 0; i < prod_cnt; ++i) {
+        producers[i].q = q;
+        producers[i].start_n = i * (total / prod_cnt) + ((i==0) ? 1 : 0);
+        producers[i].n = (total / prod_cnt) - ((i==0) ? 1 : 0);
+
+        pthread_create(&(producers[i].tid), NULL, produce<Q>, &producers[i]);
+    }
+
+    for (int i = 0; i < cons_cnt; ++i) {
+        consumers[i].q = q;
+        consumers[i].sum = 0;
+
+        pthread_create(&(consumers[i].tid), NULL, consume<Q>, &consumers[i]);
+    }
+
+    for (int i = 0; i < prod_cnt; ++i)
+        pthread_join(producers[i].tid, NULL);
+
+    exit_now = 1;
+
+    uint64_t sum = 0;
+    for (int i = 0; i < cons_cnt; ++i) {
+        pthread_join(consumers[i].tid, NULL);
+        sum += consumers[i].sum;
+    }
+
+    // Fill the queue again, the push beyond its capacity must fail
+    uint32_t pushed = 0;
+    while (q->push(typename Q::value_type(1)))
+        ++pushed;
+
+    if (pushed != Q::capacity || q->free() != 0 || q->ready() != Q::capacity) {
+        printf("FAIL: pushed %u elements in a full queue, expected %u\n", pushed, Q::capacity);
+        return -5;
+    }
+
+    // The elements left in the queue (in a wrapped range
+    // of slots) are destroyed here
+    delete q;
+
+    uint64_t expected = (uint64_t)(total-1) * total / 2;
+    if (expected != sum) {
+        printf("FAIL: obtained %lu, expected %lu\n", sum, expected);
+        return -5;
+    }
+
+    if (tracked_t::alive != 0) {
+        printf("FAIL: %i elements were not destroyed\n", tracked_t::alive);
+        return -5;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    _dbg_warn("Mutex enabled!");
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <producer-count> <consumer-count>\n", argv[0]);
+        return -1;
+    }
+
+    int prod_cnt = atoi(argv[1]);
+    int cons_cnt = atoi(argv[2]);
+
+    if (prod_cnt <= 0 || cons_cnt <= 0)
+        return -2;
+
+    if (QUEUE_SZ % prod_cnt != 0)
+        return -3;
+
+    // Many laps through the small queues
+    uint32_t small_total = SMALL_QUEUE_SZ * 1024;
+
+    int ret;
+    if (prod_cnt == 1 && cons_cnt == 1) {
+        printf("Single producer, single consumer\n");
+        ret = run<spsc_queue_t>(prod_cnt, cons_cnt, QUEUE_SZ);
+        if (!ret)
+            ret = run<small_spsc_queue_t>(prod_cnt, cons_cnt, small_total);
+    }
+    else {
+        ret = run<mpmc_queue_t>(prod_cnt, cons_cnt, QUEUE_SZ);
+        if (!ret)
+            ret = run<small_mpmc_queue_t>(prod_cnt, cons_cnt, small_total);
+    }
+
+    if (!ret)
+        ret = run<small_u32_queue_t>(prod_cnt, cons_cnt, small_total);
+
+    if (ret)
+        return ret;
+
+    printf("OK\n");
+    return 0;
+}
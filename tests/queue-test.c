@@ -1,5 +1,6 @@
 #include "loki/queue.h"
 
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,15 +11,20 @@ volatile int exit_now = 0;
 struct worker_t {
     pthread_t tid;
     struct loki_queue *q;
+    struct loki_queue_combiner *c;
 
     // prod only
     uint32_t start_n;
     uint32_t n;
     uint32_t push_len;
     int single_producer;
+    uint32_t slot_id;
+    uint32_t capacity;
+    uint32_t rejected;
+    int failed;
 
     // cons only
-    uint32_t sum;
+    uint64_t sum;
     uint32_t pop_len;
     int single_consumer;
 };
@@ -33,15 +39,34 @@ void* produce(void* arg) {
     if (ctx->single_producer)
         flags |= LOKI_SINGLE;
 
-    for (uint32_t i = ctx->start_n; i < end;) {
+    for (uint32_t i = ctx->start_n, k = 0; i < end; ++k) {
         uint32_t len = 0;
         for (; len < ctx->push_len && len+i < end; ++len) {
             block[len] = i + len;
         }
 
-        uint32_t ret = loki_queue__push(ctx->q, block, len, flags, NULL);
+        // When combining, mix requests with and without LOKI_SOME_DATA
+        // so the combiner has to split the free entries among both
+        int req_flags = flags;
+        if (ctx->c && (k & 1))
+            req_flags &= ~LOKI_SOME_DATA;
+
+        uint32_t ret, free_entries = 0;
+        if (ctx->c)
+            ret = loki_queue__push_combined(ctx->c, ctx->slot_id, block, len, req_flags, &free_entries);
+        else
+            ret = loki_queue__push(ctx->q, block, len, req_flags, &free_entries);
+
+        if (ret > len || (!(req_flags & LOKI_SOME_DATA) && ret && ret != len)
+                || free_entries > ctx->capacity) {
+            printf("FAIL: pushed %u of %u (flags %i), free entries %u\n",
+                    ret, len, req_flags, free_entries);
+            ctx->failed = 1;
+            break;
+        }
+
         if (ret == 0) {
-            printf("PUSH FAILED\n");
+            ++ctx->rejected;
         }
         else {
             i += ret;
@@ -59,6 +84,10 @@ void* consume(void* arg) {
         flags |= LOKI_SINGLE;
 
     while (1) {
+        // Read the flag before the pop: if it was set, all
+        // the producers finished and an empty pop means that
+        // there is nothing else to consume.
+        int exiting = exit_now;
         uint32_t block[ctx->pop_len];
         uint32_t ret = loki_queue__pop(ctx->q, block, ctx->pop_len, flags, NULL);
         if (ret > 0) {
@@ -66,7 +95,7 @@ void* consume(void* arg) {
                 ctx->sum += block[i];
             }
         }
-        else if (exit_now) {
+        else if (exiting) {
             break;
         }
     }
@@ -76,35 +105,55 @@ void* consume(void* arg) {
 
 int main(int argc, char *argv[]) {
     _dbg_warn("Mutex enabled!");
-    if (argc != 6) {
-        fprintf(stderr, "Usage: %s <queue-size> <producer-count> <consumer-count> <push-len> <pop-len>\n", argv[0]);
+    if (argc < 6 || argc > 8) {
+        fprintf(stderr, "Usage: %s <queue-size> <producer-count> <consumer-count> <push-len> <pop-len> [combine [elems]]\n", argv[0]);
         return -1;
     }
 
     struct loki_queue q;
+    struct loki_queue_combiner c;
     int queue_sz = atoi(argv[1]);
     int prod_cnt = atoi(argv[2]);
     int cons_cnt = atoi(argv[3]);
 
     int push_len = atoi(argv[4]);
     int pop_len  = atoi(argv[5]);
+    int combine  = (argc >= 7) ? atoi(argv[6]) : 0;
 
-    if (queue_sz < 0 || prod_cnt <= 0 || cons_cnt < 0)
+    // Push more elements than the queue can hold to
+    // see it full (and the pushes rejected)
+    int total    = (argc == 8) ? atoi(argv[7]) : queue_sz;
+
+    if (queue_sz < 0 || prod_cnt <= 0 || cons_cnt < 0 || total <= 0)
         return -2;
 
-    if (queue_sz % prod_cnt != 0)
+    if (queue_sz % prod_cnt != 0 || total % prod_cnt != 0)
         return -3;
 
+    if (combine && prod_cnt > LOKI_COMBINER_SLOTS)
+        return -2;
+
     if (loki_queue__init(&q, queue_sz, sizeof(uint32_t)))
         return -4;
 
+    if (combine) {
+        if (loki_queue_combiner__init(&c, &q, prod_cnt))
+            return -4;
+        printf("Combining pushes\n");
+    }
+
     struct worker_t producers[prod_cnt];
     struct worker_t consumers[cons_cnt];
 
     for (int i = 0; i < prod_cnt; ++i) {
         producers[i].q = &q;
-        producers[i].start_n = i * (queue_sz / prod_cnt) + ((i==0) ? 1 : 0);
-        producers[i].n = (queue_sz / prod_cnt) - ((i==0) ? 1 : 0);
+        producers[i].c = combine ? &c : NULL;
+        producers[i].slot_id = i;
+        producers[i].start_n = i * (total / prod_cnt) + ((i==0) ? 1 : 0);
+        producers[i].n = (total / prod_cnt) - ((i==0) ? 1 : 0);
+        producers[i].capacity = queue_sz - 1;
+        producers[i].rejected = 0;
+        producers[i].failed = 0;
         producers[i].push_len = push_len;
         producers[i].single_producer = (prod_cnt == 1);
 
@@ -132,9 +181,11 @@ int main(int argc, char *argv[]) {
     }
 
     printf("Waiting for the producers\n");
+    int failed = 0;
     for (int i = 0; i < prod_cnt; ++i) {
         pthread_join(producers[i].tid, NULL);
-        printf("Producer %i done\n", i);
+        failed |= producers[i].failed;
+        printf("Producer %i done, %u pushes rejected\n", i, producers[i].rejected);
     }
 
     // all the iterms were pushed by the producers,
@@ -144,18 +195,23 @@ int main(int argc, char *argv[]) {
     exit_now = 1;
 
     printf("Waiting for the consumers\n");
-    uint32_t sum = 0;
+    uint64_t sum = 0;
     for (int i = 0; i < cons_cnt; ++i) {
         pthread_join(consumers[i].tid, NULL);
         sum += consumers[i].sum;
         printf("Consumer %i done\n", i);
     }
 
+    if (combine)
+        loki_queue_combiner__destroy(&c);
     loki_queue__destroy(&q);
 
-    uint32_t expected = (queue_sz-1) * (queue_sz / 2);
+    if (failed)
+        return -5;
+
+    uint64_t expected = (uint64_t)(total-1) * total / 2;
     if (expected != sum) {
-        printf("FAIL: obtained %u, expected %u\n", sum, expected);
+        printf("FAIL: obtained %" PRIu64 ", expected %" PRIu64 "\n", sum, expected);
         return -5;
     }
 
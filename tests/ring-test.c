@@ -0,0 +1,182 @@
+#include "loki/ring.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+volatile int exit_now = 0;
+
+// The second half is the complement of the first one so
+// a torn read can be detected.
+struct elem_t {
+    uint32_t producer;
+    uint32_t value;
+    uint32_t check_producer;
+    uint32_t check_value;
+};
+
+struct worker_t {
+    pthread_t tid;
+    struct loki_ring *r;
+    uint32_t id;
+
+    // prod only
+    uint32_t n;
+    uint32_t push_len;
+
+    // reader only
+    struct loki_ring_reader reader;
+    uint32_t read_len;
+    uint32_t prod_cnt;
+    uint64_t received;
+    uint64_t dropped;
+    int failed;
+};
+
+void* produce(void* arg) {
+    struct worker_t *ctx = arg;
+    struct elem_t block[ctx->push_len];
+
+    for (uint32_t i = 0; i < ctx->n;) {
+        uint32_t len = 0;
+        for (; len < ctx->push_len && len+i < ctx->n; ++len) {
+            block[len].producer = ctx->id;
+            block[len].value = i + len;
+            block[len].check_producer = ~ctx->id;
+            block[len].check_value = ~(i + len);
+        }
+
+        i += loki_ring__push(ctx->r, block, len);
+    }
+
+    return NULL;
+}
+
+void* read_all(void* arg) {
+    struct worker_t *ctx = arg;
+    struct elem_t block[ctx->read_len];
+
+    // The values of each producer must be seen in order
+    int64_t last[ctx->prod_cnt];
+    for (uint32_t i = 0; i < ctx->prod_cnt; ++i)
+        last[i] = -1;
+
+    while (1) {
+        // Read the flag before reading the ring: if it was set,
+        // all the producers finished and an empty read means
+        // that there is nothing else to read.
+        int exiting = exit_now;
+        uint32_t ret = loki_ring__read(ctx->r, &ctx->reader, block, ctx->read_len, &ctx->dropped);
+
+        for (uint32_t i = 0; i < ret; ++i) {
+            struct elem_t *e = &block[i];
+            if (e->producer != ~e->check_producer || e->value != ~e->check_value
+                    || e->producer >= ctx->prod_cnt) {
+                printf("FAIL: torn entry %08x %08x %08x %08x\n",
+                        e->producer, e->value, e->check_producer, e->check_value);
+                ctx->failed = 1;
+                continue;
+            }
+
+            if ((int64_t)e->value <= last[e->producer]) {
+                printf("FAIL: producer %u out of order, %u after %" PRId64 "\n",
+                        e->producer, e->value, last[e->producer]);
+                ctx->failed = 1;
+            }
+            last[e->producer] = e->value;
+        }
+        ctx->received += ret;
+
+        if (!ret && exiting)
+            break;
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    _dbg_warn("Mutex enabled!");
+    if (argc != 7) {
+        fprintf(stderr, "Usage: %s <ring-size> <producer-count> <reader-count> <push-len> <read-len> <elems-per-producer>\n", argv[0]);
+        return -1;
+    }
+
+    struct loki_ring r;
+    int ring_sz = atoi(argv[1]);
+    int prod_cnt = atoi(argv[2]);
+    int reader_cnt = atoi(argv[3]);
+
+    int push_len = atoi(argv[4]);
+    int read_len = atoi(argv[5]);
+    int n = atoi(argv[6]);
+
+    if (ring_sz <= 0 || prod_cnt <= 0 || reader_cnt < 0 || push_len <= 0 || read_len <= 0 || n <= 0)
+        return -2;
+
+    if (loki_ring__init(&r, ring_sz, sizeof(struct elem_t)))
+        return -4;
+
+    struct worker_t producers[prod_cnt];
+    struct worker_t readers[reader_cnt];
+
+    // Start the readers first so they see all the entries
+    for (int i = 0; i < reader_cnt; ++i) {
+        readers[i].r = &r;
+        readers[i].id = i;
+        readers[i].read_len = read_len;
+        readers[i].prod_cnt = prod_cnt;
+        readers[i].received = 0;
+        readers[i].dropped = 0;
+        readers[i].failed = 0;
+        loki_ring_reader__init(&readers[i].reader, &r);
+
+        pthread_create(&(readers[i].tid), NULL, read_all, &readers[i]);
+    }
+
+    for (int i = 0; i < prod_cnt; ++i) {
+        producers[i].r = &r;
+        producers[i].id = i;
+        producers[i].n = n;
+        producers[i].push_len = push_len;
+
+        pthread_create(&(producers[i].tid), NULL, produce, &producers[i]);
+    }
+
+    printf("Waiting for the producers\n");
+    for (int i = 0; i < prod_cnt; ++i) {
+        pthread_join(producers[i].tid, NULL);
+        printf("Producer %i done\n", i);
+    }
+
+    printf("Signal the readers to exit\n");
+    exit_now = 1;
+
+    // Each reader must account for every entry: it either
+    // read it or it knows that it was dropped.
+    uint64_t expected = (uint64_t)n * prod_cnt;
+    int ret = 0;
+    for (int i = 0; i < reader_cnt; ++i) {
+        pthread_join(readers[i].tid, NULL);
+        printf("Reader %i done: received %" PRIu64 ", dropped %" PRIu64 "\n",
+                i, readers[i].received, readers[i].dropped);
+
+        if (readers[i].failed) {
+            ret = -5;
+        }
+        else if (readers[i].received + readers[i].dropped != expected) {
+            printf("FAIL: reader %i accounted for %" PRIu64 " entries, expected %" PRIu64 "\n",
+                    i, readers[i].received + readers[i].dropped, expected);
+            ret = -5;
+        }
+    }
+
+    loki_ring__destroy(&r);
+
+    if (ret)
+        return ret;
+
+    printf("OK\n");
+    return 0;
+}